@@ -1,10 +1,12 @@
 // rom/boot_rom.c — A/B slots, PK-hash binding, Dilithium verify, OTP counter
-// (color, strict sizes, size policy, zero-padding enforcement)
+// (color, strict sizes, size policy, zero-padding enforcement,
+//  lazy per-block verity payloads)
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include "otp_pk.h"
 #include "image_format.h"
 #include <openssl/evp.h>
@@ -27,8 +29,16 @@
 #define FW_MAX_BYTES (64u << 20)  // 64 MiB
 #endif
 
+// Simulated boot: bytes of a verity payload touched before handoff
+#ifndef BOOT_TOUCH_BYTES
+#define BOOT_TOUCH_BYTES (1u << 20)  // 1 MiB
+#endif
+
 #define OTP_PK_HASH (OTP_PK_HASHES[0])
 
+static size_t g_touch_bytes  = BOOT_TOUCH_BYTES;
+static int    g_compare_full = 0;
+
 // --- Protos from sw/verify_lib.c ---
 int dilithium_verify_digest(const uint8_t* digest, size_t digest_len,
                             const uint8_t* sig, size_t sig_len,
@@ -72,6 +82,91 @@ static int fw_digest(const uint8_t* data, size_t len, uint8_t out[64]) {
   return ok ? 0 : -1;
 }
 
+// Verity digest: SHAKE-256("BOOT_FW_VERITY_V1" || fw_size || fw_verity_t) → 64 bytes
+static int verity_digest(uint32_t fw_size, const fw_verity_t* v, uint8_t out[64]) {
+  EVP_MD_CTX* c = EVP_MD_CTX_new(); if (!c) return -1;
+  if (EVP_DigestInit_ex(c, EVP_shake256(), NULL) != 1) { EVP_MD_CTX_free(c); return -1; }
+  const char dom[] = "BOOT_FW_VERITY_V1";
+  if (EVP_DigestUpdate(c, dom, sizeof(dom)-1) != 1)        { EVP_MD_CTX_free(c); return -1; }
+  if (EVP_DigestUpdate(c, &fw_size, sizeof(fw_size)) != 1) { EVP_MD_CTX_free(c); return -1; }
+  if (EVP_DigestUpdate(c, v, sizeof(*v)) != 1)             { EVP_MD_CTX_free(c); return -1; }
+  int ok = EVP_DigestFinalXOF(c, out, 64) == 1;
+  EVP_MD_CTX_free(c);
+  return ok ? 0 : -1;
+}
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static long file_size(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return -1;
+  if (fseek(f, 0, SEEK_END) != 0) { fclose(f); return -1; }
+  long n = ftell(f);
+  fclose(f);
+  return n;
+}
+
+// --- Lazy verity payload: blocks are paged in and hashed on first access ---
+// Verified blocks live in `mem`; a block is never re-read from storage once
+// checked, so later accesses cannot observe a swapped-out block.
+typedef struct {
+  FILE*          f;
+  uint32_t       fw_size, block_size, block_count;
+  const uint8_t* hashes;     // block_count × VERITY_HASH_LEN, root-checked
+  uint8_t*       mem;        // fw_size bytes, populated on demand
+  uint8_t*       verified;   // one flag per block
+  uint32_t       nverified;
+} verity_fw_t;
+
+static int verity_open(verity_fw_t* v, const char* path, uint32_t fw_size,
+                       const fw_verity_t* vd, const uint8_t* hashes) {
+  memset(v, 0, sizeof(*v));
+  v->fw_size = fw_size; v->block_size = vd->block_size; v->block_count = vd->block_count;
+  v->hashes = hashes;
+  v->f = fopen(path, "rb");
+  v->mem = (uint8_t*)malloc(fw_size);
+  v->verified = (uint8_t*)calloc(vd->block_count, 1);
+  return (v->f && v->mem && v->verified) ? 0 : -1;
+}
+
+static void verity_close(verity_fw_t* v) {
+  if (v->f) fclose(v->f);
+  free(v->mem); free(v->verified);
+  memset(v, 0, sizeof(*v));
+}
+
+// Page in and check one block. Returns 0 if verified, -1 on I/O or hash mismatch.
+static int verity_fault(verity_fw_t* v, uint32_t blk) {
+  if (v->verified[blk]) return 0;
+  size_t off = (size_t)blk * v->block_size;
+  size_t n = v->fw_size - off < v->block_size ? v->fw_size - off : v->block_size;
+  uint8_t h[32];
+  if (fseek(v->f, (long)off, SEEK_SET) != 0) return -1;
+  if (fread(v->mem + off, 1, n, v->f) != n) return -1;
+  if (sha256(v->mem + off, n, h) != 0) return -1;
+  if (memcmp(h, v->hashes + (size_t)blk * VERITY_HASH_LEN, VERITY_HASH_LEN) != 0) {
+    memset(v->mem + off, 0, n);
+    printf(C_RED "[-] Verity block %u hash mismatch\n" C_RST, blk);
+    return -1;
+  }
+  v->verified[blk] = 1; v->nverified++;
+  return 0;
+}
+
+// Map [off, off+len) of the payload. Returns NULL if any covering block fails.
+static const uint8_t* verity_map(verity_fw_t* v, size_t off, size_t len) {
+  if (len == 0 || off >= v->fw_size || len > v->fw_size - off) return NULL;
+  uint32_t first = (uint32_t)(off / v->block_size);
+  uint32_t last  = (uint32_t)((off + len - 1) / v->block_size);
+  for (uint32_t b = first; b <= last; b++)
+    if (verity_fault(v, b) != 0) return NULL;
+  return v->mem + off;
+}
+
 // --- Monotonic OTP counter stored in out/otp_counter.bin ---
 static uint32_t otp_read(void){
   FILE* f = fopen("out/otp_counter.bin","rb");
@@ -91,18 +186,30 @@ static void otp_write(uint32_t v){
 // --- Verify one slot (header + payload). Returns 1 on PASS, 0 on FAIL. ---
 static int verify_slot(const char* hdr_path, const char* fw_path) {
   uint8_t *hdr=NULL, *fw=NULL; size_t hdr_len=0, fw_len=0;
+  verity_fw_t vf; memset(&vf, 0, sizeof(vf));
+  double t0 = now_ms();
 
   printf(C_YEL "[*] Verifying slot: %s, %s\n" C_RST, hdr_path, fw_path);
 
-  if (load_file(hdr_path, &hdr, &hdr_len) || load_file(fw_path, &fw, &fw_len)) {
+  if (load_file(hdr_path, &hdr, &hdr_len)) {
     printf(C_RED "[-] Failed to load header/payload\n" C_RST); goto fail;
   }
   if (hdr_len < HDR_SIZE) { printf(C_RED "[-] Header too small\n" C_RST); goto fail; }
 
   fw_header_t h; memcpy(&h, hdr, sizeof(fw_header_t));
+  int verity = h.magic == HDR_MAGIC_VERITY;
+
+  // Verity payloads are paged in lazily; only their size is needed up front
+  if (verity) {
+    long n = file_size(fw_path);
+    if (n <= 0) { printf(C_RED "[-] Failed to load header/payload\n" C_RST); goto fail; }
+    fw_len = (size_t)n;
+  } else if (load_file(fw_path, &fw, &fw_len)) {
+    printf(C_RED "[-] Failed to load header/payload\n" C_RST); goto fail;
+  }
 
   // Basic structural checks
-  if (h.magic != HDR_MAGIC || h.header_size != HDR_SIZE) {
+  if ((h.magic != HDR_MAGIC && !verity) || h.header_size != HDR_SIZE) {
     printf(C_RED "[-] Bad magic or header_size\n" C_RST); goto fail;
   }
   if (h.fw_size != fw_len) {
@@ -128,9 +235,27 @@ static int verify_slot(const char* hdr_path, const char* fw_path) {
   const uint8_t* pk   = blob;
   const uint8_t* sig  = blob + h.pk_len;
 
+  // Verity descriptor sits between sig and padding; hash region follows the header
+  fw_verity_t vd; memset(&vd, 0, sizeof(vd));
+  const uint8_t* hashes = hdr + HDR_SIZE;
+  if (verity) {
+    memcpy(&vd, blob + h.pk_len + h.sig_len, sizeof(vd));
+    if (vd.block_size < VERITY_MIN_BLOCK || vd.block_size > VERITY_MAX_BLOCK ||
+        (vd.block_size & (vd.block_size - 1)) != 0 ||
+        vd.block_count != (h.fw_size + vd.block_size - 1) / vd.block_size) {
+      printf(C_RED "[-] Bad verity geometry (block=%u, count=%u)\n" C_RST,
+             vd.block_size, vd.block_count);
+      goto fail;
+    }
+    if (hdr_len != (size_t)HDR_SIZE + (size_t)vd.block_count * VERITY_HASH_LEN) {
+      printf(C_RED "[-] Verity hash region size mismatch\n" C_RST); goto fail;
+    }
+  }
+
   // Require header padding area to be zero
   {
-    size_t pad_off = (size_t)HDR_BLOB_OFFSET + (size_t)h.pk_len + (size_t)h.sig_len;
+    size_t pad_off = (size_t)HDR_BLOB_OFFSET + (size_t)h.pk_len + (size_t)h.sig_len +
+                     (verity ? sizeof(fw_verity_t) : 0);
     for (size_t i = pad_off; i < (size_t)HDR_SIZE; i++) {
       if (hdr[i] != 0) {
         printf(C_RED "[-] Header padding is non-zero\n" C_RST); goto fail;
@@ -143,9 +268,18 @@ static int verify_slot(const char* hdr_path, const char* fw_path) {
   if (sha256(pk, h.pk_len, pk_hash) != 0) { printf(C_RED "[-] pk hash calc failed\n" C_RST); goto fail; }
   if (memcmp(pk_hash, OTP_PK_HASH, 32) != 0) { printf(C_RED "[-] PK mismatch vs OTP\n" C_RST); goto fail; }
 
-  // Firmware digest
+  // Firmware digest (verity: root over the hash region stands in for the payload)
   uint8_t digest[64];
-  if (fw_digest(fw, fw_len, digest) != 0) { printf(C_RED "[-] Digest failed\n" C_RST); goto fail; }
+  if (verity) {
+    uint8_t root[32];
+    if (sha256(hashes, (size_t)vd.block_count * VERITY_HASH_LEN, root) != 0 ||
+        memcmp(root, vd.root, sizeof(root)) != 0) {
+      printf(C_RED "[-] Verity root mismatch\n" C_RST); goto fail;
+    }
+    if (verity_digest(h.fw_size, &vd, digest) != 0) { printf(C_RED "[-] Digest failed\n" C_RST); goto fail; }
+  } else if (fw_digest(fw, fw_len, digest) != 0) {
+    printf(C_RED "[-] Digest failed\n" C_RST); goto fail;
+  }
 
   // Dilithium verify
   if (dilithium_verify_digest(digest, sizeof(digest), sig, h.sig_len, pk, h.pk_len) != 0) {
@@ -157,25 +291,71 @@ static int verify_slot(const char* hdr_path, const char* fw_path) {
   if (h.version < vmin) {
     printf(C_RED "[-] Rollback: version=%u < %u\n" C_RST, h.version, vmin); goto fail;
   }
+
+  if (verity) {
+    double t_hdr = now_ms() - t0;
+    if (verity_open(&vf, fw_path, h.fw_size, &vd, hashes) != 0) {
+      printf(C_RED "[-] Failed to load header/payload\n" C_RST); goto fail;
+    }
+
+    // Simulated boot: fetch the entry block, then whatever the boot path touches.
+    // Both are checked before the OTP counter moves, so a bad slot still fails over.
+    if (!verity_map(&vf, 0, 1)) { printf(C_RED "[-] Verity fault in entry block\n" C_RST); goto fail; }
+    double t_first = now_ms() - t0;
+    size_t touch = g_touch_bytes < h.fw_size ? g_touch_bytes : h.fw_size;
+    if (touch && !verity_map(&vf, 0, touch)) { printf(C_RED "[-] Verity fault in boot window\n" C_RST); goto fail; }
+    double t_boot = now_ms() - t0;
+
+    printf("[i] verity: header+root+sig %.3f ms, first block %.3f ms\n", t_hdr, t_first);
+    printf("[i] verity: boot touched %u/%u blocks (%zu bytes) in %.3f ms\n",
+           vf.nverified, vf.block_count, touch, t_boot);
+    if (g_compare_full) {
+      if (!verity_map(&vf, 0, h.fw_size)) { printf(C_RED "[-] Full verify FAIL\n" C_RST); goto fail; }
+      printf("[i] verity: full verify %u/%u blocks in %.3f ms\n",
+             vf.nverified, vf.block_count, now_ms() - t0);
+    }
+  }
+
   if (h.version > vmin) {
     otp_write(h.version);
     printf(C_GRN "[+] OTP counter updated to %u\n" C_RST, h.version);
   }
 
+  if (verity) {
+    printf(C_GRN "[+] VERIFY PASS (verity, lazy) — jumping to firmware (%s)\n" C_RST, fw_path);
+    verity_close(&vf);
+    free(hdr);
+    return 1;
+  }
+
   printf(C_GRN "[+] VERIFY PASS — jumping to firmware (%s)\n" C_RST, fw_path);
   free(hdr); free(fw);
   return 1;
 
 fail:
+  verity_close(&vf);
   if (hdr) free(hdr);
   if (fw)  free(fw);
   return 0;
 }
 
-// --- Main: <hdr_a> <fw_a> <hdr_b> <fw_b> ---
+// --- Main: [--touch=<bytes>] [--compare-full] <hdr_a> <fw_a> <hdr_b> <fw_b> ---
 int main(int argc, char** argv) {
-  if (argc != 5) {
-    fprintf(stderr, "Usage: %s <hdr_a> <fw_a> <hdr_b> <fw_b>\n", argv[0]);
+  int bad_opt = 0;
+  while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+    if (strncmp(argv[1], "--touch=", 8) == 0) {
+      char* end = NULL;
+      const char* val = argv[1] + 8;
+      unsigned long n = strtoul(val, &end, 0);
+      if (*val == '\0' || *val == '-' || *end != '\0') { bad_opt = 1; break; }
+      g_touch_bytes = (size_t)n;
+    }
+    else if (strcmp(argv[1], "--compare-full") == 0) g_compare_full = 1;
+    else break;
+    argv++; argc--;
+  }
+  if (bad_opt || argc != 5) {
+    fprintf(stderr, "Usage: %s [--touch=<bytes>] [--compare-full] <hdr_a> <fw_a> <hdr_b> <fw_b>\n", argv[0]);
     return 1;
   }
   if (verify_slot(argv[1], argv[2])) return 0;
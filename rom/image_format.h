@@ -18,3 +18,21 @@ typedef struct __attribute__((packed)) {
 // Ensure struct is exactly 24 bytes
 _Static_assert(sizeof(fw_header_t) == HDR_BLOB_OFFSET,
                "fw_header_t must be 24 bytes");
+
+// ---- Verity (lazy, per-block verified) images ----
+// Layout: fw_header_t | pk | sig | fw_verity_t | zero pad up to HDR_SIZE,
+// then the hash region: block_count × SHA-256(block) starting at HDR_SIZE.
+// root = SHA-256(hash region). The signature covers
+// SHAKE-256("BOOT_FW_VERITY_V1" || fw_size || fw_verity_t) → 64 bytes.
+#define HDR_MAGIC_VERITY   0x44494C56u  // 'DILV'
+#define VERITY_HASH_LEN    32u
+#define VERITY_MIN_BLOCK   512u
+#define VERITY_MAX_BLOCK   (1u << 20)
+
+typedef struct __attribute__((packed)) {
+  uint32_t block_size;    // power of two, VERITY_MIN_BLOCK..VERITY_MAX_BLOCK
+  uint32_t block_count;   // ceil(fw_size / block_size)
+  uint8_t  root[VERITY_HASH_LEN];
+} fw_verity_t;
+
+_Static_assert(sizeof(fw_verity_t) == 40, "fw_verity_t must be 40 bytes");
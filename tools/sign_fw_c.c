@@ -9,6 +9,7 @@
 #include "image_format.h"   // <- brings fw_header_t, HDR_MAGIC, HDR_SIZE, D2_* and HDR_BLOB_OFFSET
 
 static const char *k_domain = "BOOT_FW_V1";
+static const char *k_verity_domain = "BOOT_FW_VERITY_V1";
 #define DIGEST_LEN 64
 
 static int read_all(const char *path, uint8_t **buf, size_t *len) {
@@ -46,10 +47,52 @@ out:
   return rc;
 }
 
+static int sha256(const uint8_t *in, size_t inlen, uint8_t out[32]) {
+  unsigned int olen = 0;
+  EVP_MD_CTX *c = EVP_MD_CTX_new(); if (!c) return -1;
+  int ok = EVP_DigestInit_ex(c, EVP_sha256(), NULL) == 1 &&
+           EVP_DigestUpdate(c, in, inlen) == 1 &&
+           EVP_DigestFinal_ex(c, out, &olen) == 1 && olen == 32;
+  EVP_MD_CTX_free(c);
+  return ok ? 0 : -1;
+}
+
+// Verity: per-block SHA-256 hash region + root, and the digest that gets signed
+static int verity_build(const uint8_t *payload, size_t plen, uint32_t block_size,
+                        fw_verity_t *v, uint8_t **region, size_t *region_len,
+                        uint8_t *out, size_t outlen) {
+  v->block_size  = block_size;
+  v->block_count = (uint32_t)((plen + block_size - 1) / block_size);
+  *region_len = (size_t)v->block_count * VERITY_HASH_LEN;
+  *region = (uint8_t*)malloc(*region_len);
+  if (!*region) return -1;
+
+  for (uint32_t i = 0; i < v->block_count; i++) {
+    size_t off = (size_t)i * block_size;
+    size_t n = plen - off < block_size ? plen - off : block_size;
+    if (sha256(payload + off, n, *region + (size_t)i * VERITY_HASH_LEN) != 0) return -2;
+  }
+  if (sha256(*region, *region_len, v->root) != 0) return -3;
+
+  int rc = -4;
+  uint32_t fw_size = (uint32_t)plen;
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  if (!ctx) return -5;
+  if (EVP_DigestInit_ex(ctx, EVP_shake256(), NULL) != 1) goto out;
+  if (EVP_DigestUpdate(ctx, (const uint8_t*)k_verity_domain, strlen(k_verity_domain)) != 1) goto out;
+  if (EVP_DigestUpdate(ctx, &fw_size, sizeof(fw_size)) != 1) goto out;
+  if (EVP_DigestUpdate(ctx, v, sizeof(*v)) != 1) goto out;
+  if (EVP_DigestFinalXOF(ctx, out, outlen) != 1) goto out;
+  rc = 0;
+out:
+  EVP_MD_CTX_free(ctx);
+  return rc;
+}
+
 int main(int argc, char **argv) {
-  // Usage: sign_fw_c <fw_payload.bin> <pubkey.bin> <seckey.bin> <version> <out_header>
-  if (argc != 6) {
-    fprintf(stderr, "Usage: %s <fw_payload.bin> <pubkey.bin> <seckey.bin> <version> <out_header>\n", argv[0]);
+  // Usage: sign_fw_c <fw_payload.bin> <pubkey.bin> <seckey.bin> <version> <out_header> [verity_block_size]
+  if (argc != 6 && argc != 7) {
+    fprintf(stderr, "Usage: %s <fw_payload.bin> <pubkey.bin> <seckey.bin> <version> <out_header> [verity_block_size]\n", argv[0]);
     return 2;
   }
   const char *fw_path = argv[1];
@@ -57,6 +100,15 @@ int main(int argc, char **argv) {
   const char *sk_path = argv[3];
   unsigned long version = strtoul(argv[4], NULL, 0);
   const char *out_hdr = argv[5];
+  unsigned long block_size = argc == 7 ? strtoul(argv[6], NULL, 0) : 0;
+  int verity = argc == 7;
+
+  if (verity && (block_size < VERITY_MIN_BLOCK || block_size > VERITY_MAX_BLOCK ||
+                 (block_size & (block_size - 1)) != 0)) {
+    fprintf(stderr, "[-] verity block size must be a power of two in [%u, %u]\n",
+            VERITY_MIN_BLOCK, VERITY_MAX_BLOCK);
+    return 2;
+  }
 
   uint8_t *fw=NULL, *pk=NULL, *sk=NULL;
   size_t fw_len=0, pk_len=0, sk_len=0;
@@ -74,7 +126,17 @@ int main(int argc, char **argv) {
   }
 
   uint8_t digest[DIGEST_LEN];
-  if (shake256_digest(fw, fw_len, digest, DIGEST_LEN) != 0) {
+  fw_verity_t vd;
+  uint8_t *region = NULL;
+  size_t region_len = 0;
+  memset(&vd, 0, sizeof(vd));
+  if (verity) {
+    if (verity_build(fw, fw_len, (uint32_t)block_size, &vd, &region, &region_len,
+                     digest, DIGEST_LEN) != 0) {
+      fprintf(stderr, "[-] verity hash region failed\n");
+      return 1;
+    }
+  } else if (shake256_digest(fw, fw_len, digest, DIGEST_LEN) != 0) {
     fprintf(stderr, "[-] digest failed\n");
     return 1;
   }
@@ -103,7 +165,7 @@ int main(int argc, char **argv) {
   memset(header, 0, sizeof(header));
 
   fw_header_t h = {
-    .magic       = HDR_MAGIC,
+    .magic       = verity ? HDR_MAGIC_VERITY : HDR_MAGIC,
     .header_size = HDR_SIZE,
     .version     = (uint32_t)version,
     .fw_size     = (uint32_t)fw_len,
@@ -114,26 +176,41 @@ int main(int argc, char **argv) {
   // Copy fixed struct first
   memcpy(header, &h, sizeof(h));
 
-  // Copy pk||sig at defined blob offset
-  if ((size_t)HDR_BLOB_OFFSET + pk_len + sig_len > (size_t)HDR_SIZE) {
+  // Copy pk||sig (|| verity descriptor) at defined blob offset
+  size_t vd_len = verity ? sizeof(vd) : 0;
+  if ((size_t)HDR_BLOB_OFFSET + pk_len + sig_len + vd_len > (size_t)HDR_SIZE) {
     fprintf(stderr, "[-] header too small for pk+sig (need %zu)\n",
-            (size_t)HDR_BLOB_OFFSET + pk_len + sig_len);
-    free(sig); OQS_SIG_free(s); free(fw); free(pk); free(sk);
+            (size_t)HDR_BLOB_OFFSET + pk_len + sig_len + vd_len);
+    free(sig); OQS_SIG_free(s); free(fw); free(pk); free(sk); free(region);
     return 1;
   }
   memcpy(header + HDR_BLOB_OFFSET, pk, pk_len);
   memcpy(header + HDR_BLOB_OFFSET + pk_len, sig, sig_len);
+  if (verity) memcpy(header + HDR_BLOB_OFFSET + pk_len + sig_len, &vd, sizeof(vd));
+
+  // Verity hash region follows the header in the same file
+  uint8_t *image = (uint8_t*)malloc(sizeof(header) + region_len);
+  if (!image) {
+    fprintf(stderr, "malloc header failed\n");
+    free(sig); OQS_SIG_free(s); free(fw); free(pk); free(sk); free(region);
+    return 1;
+  }
+  memcpy(image, header, sizeof(header));
+  if (region_len) memcpy(image + sizeof(header), region, region_len);
 
-  if (write_all(out_hdr, header, sizeof(header)) != 0) {
+  if (write_all(out_hdr, image, sizeof(header) + region_len) != 0) {
     fprintf(stderr, "[-] write header failed\n");
-    free(sig); OQS_SIG_free(s); free(fw); free(pk); free(sk);
+    free(image); free(sig); OQS_SIG_free(s); free(fw); free(pk); free(sk); free(region);
     return 1;
   }
 
   fprintf(stdout, "[+] header written: %s (pk=%zu, sig=%zu, fw=%zu, ver=%lu)\n",
           out_hdr, pk_len, sig_len, fw_len, version);
+  if (verity)
+    fprintf(stdout, "[+] verity: %u blocks of %u bytes, hash region %zu bytes\n",
+            vd.block_count, vd.block_size, region_len);
 
-  free(sig); OQS_SIG_free(s);
-  free(fw); free(pk); free(sk);
+  free(image); free(sig); OQS_SIG_free(s);
+  free(fw); free(pk); free(sk); free(region);
   return 0;
 }
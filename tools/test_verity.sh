@@ -0,0 +1,110 @@
+#!/usr/bin/env bash
+set -euo pipefail
+cd "$(dirname "$0")/.."
+ESC=$(printf '\033'); RESET="${ESC}[0m"; BOLD="${ESC}[1m"
+CYAN="${ESC}[36m"; GREEN="${ESC}[32m"; RED="${ESC}[31m"; YELLOW="${ESC}[33m"
+say(){ printf "%b\n" "${BOLD}${CYAN}$*${RESET}"; }
+pass(){ printf "%b\n" "${BOLD}${GREEN}$*${RESET}"; }
+fail(){ printf "%b\n" "${BOLD}${RED}$*${RESET}"; }
+note(){ printf "%b\n" "${YELLOW}$*${RESET}"; }
+# Invert one byte in place (always changes it, unlike overwriting with a constant)
+flip(){
+  local b; b=$(od -An -tu1 -j "$2" -N1 "$1" | tr -d ' ')
+  printf "\\$(printf '%03o' $((b ^ 0xff)))" | dd of="$1" bs=1 seek="$2" conv=notrunc status=none
+}
+otp(){ od -An -tu4 out/otp_counter.bin | tr -d ' '; }
+set_otp(){ printf "\\$(printf '%03o' "$1")\x00\x00\x00" > out/otp_counter.bin; }
+
+SIZE=${SIZE:-$((16 * 1024 * 1024))}
+BLOCK=${BLOCK:-4096}
+TOUCH=${TOUCH:-$((1024 * 1024))}
+
+mkdir -p out
+[ -f out/pub.key ] || ./tools/gen_keys_c out/pub.key out/sec.key
+./tools/gen_otp_header.sh out/pub.key
+make -s rom_mock sign_fw_c
+printf '\x00\x00\x00\x00' > out/otp_counter.bin
+
+say "[verity] Lazy per-block payload verification (size=$SIZE, block=$BLOCK, touch=$TOUCH)"
+dd if=/dev/urandom of=out/p_verity bs=1M count=$((SIZE / 1048576)) status=none
+./tools/sign_fw_c out/p_verity out/pub.key out/sec.key 1 out/h_full
+./tools/sign_fw_c out/p_verity out/pub.key out/sec.key 1 out/h_verity "$BLOCK"
+
+# Baseline: full digest before handoff
+TIMEFORMAT="%3R"
+t_full=$( { time ./rom_mock out/h_full out/p_verity out/h_full out/p_verity >/dev/null; } 2>&1 )
+note "full-digest boot: ${t_full}s"
+
+# Lazy: header/root/sig up front, then only the blocks the boot touches
+if ./rom_mock --touch="$TOUCH" --compare-full out/h_verity out/p_verity out/h_verity out/p_verity; then
+  pass "✔ Verity PASS"
+else
+  fail "✘ Unexpected FAIL on verity baseline"; exit 1
+fi
+
+# Tamper a block outside the boot window → boot succeeds, full verify catches it
+cp out/p_verity out/p_verity_late
+flip out/p_verity_late $((SIZE - 1))
+if ./rom_mock --touch="$TOUCH" out/h_verity out/p_verity_late out/h_verity out/p_verity_late >/dev/null; then
+  pass "✔ Untouched tampered block not read during boot"
+else
+  fail "✘ Boot read a block it did not need"; exit 1
+fi
+if ./rom_mock --touch="$TOUCH" --compare-full out/h_verity out/p_verity_late out/h_verity out/p_verity_late; then
+  fail "✘ Full verify should have FAILED on tampered block"; exit 1
+else
+  pass "✔ FAIL observed (late block hash mismatch)"
+fi
+
+# Tamper the entry block → fault before handoff
+cp out/p_verity out/p_verity_entry
+flip out/p_verity_entry 128
+if ./rom_mock out/h_verity out/p_verity_entry out/h_verity out/p_verity_entry; then
+  fail "✘ Should have FAILED on entry block"; exit 1
+else
+  pass "✔ FAIL observed (entry block hash mismatch)"
+fi
+
+# Tamper the hash region → root mismatch
+cp out/h_verity out/h_verity_bad
+flip out/h_verity_bad $((4096 + 32))
+if ./rom_mock out/h_verity_bad out/p_verity out/h_verity_bad out/p_verity; then
+  fail "✘ Should have FAILED on hash region tamper"; exit 1
+else
+  pass "✔ FAIL observed (verity root mismatch)"
+fi
+
+# Tamper a block inside the boot window (not the entry block) → fail before OTP moves
+./tools/sign_fw_c out/p_verity out/pub.key out/sec.key 7 out/h_verity_v7 "$BLOCK"
+cp out/p_verity out/p_verity_win
+flip out/p_verity_win $((10 * BLOCK + 5))
+otp_before=$(otp)
+if ./rom_mock out/h_verity_v7 out/p_verity_win out/h_verity_v7 out/p_verity_win; then
+  fail "✘ Should have FAILED on boot-window block"; exit 1
+elif [ "$(otp)" != "$otp_before" ]; then
+  fail "✘ OTP counter moved ($otp_before → $(otp)) on a faulted boot"; exit 1
+else
+  pass "✔ FAIL observed (boot-window block), OTP unchanged at $otp_before"
+fi
+
+# A/B recovery: slot A is newer but corrupt in the boot window, slot B is clean
+set_otp 4
+./tools/sign_fw_c out/p_verity out/pub.key out/sec.key 5 out/h_verity_v5 "$BLOCK"
+./tools/sign_fw_c out/p_verity out/pub.key out/sec.key 4 out/h_verity_v4 "$BLOCK"
+cp out/p_verity out/p_verity_a
+flip out/p_verity_a $((122 * BLOCK))
+if ./rom_mock out/h_verity_v5 out/p_verity_a out/h_verity_v4 out/p_verity && [ "$(otp)" = 4 ]; then
+  pass "✔ Slot B booted after slot A fault, OTP still 4"
+else
+  fail "✘ A/B recovery failed (OTP=$(otp))"; exit 1
+fi
+
+# Malformed --touch is rejected rather than silently parsed
+for bad in 1M abc ""; do
+  if ./rom_mock --touch="$bad" out/h_verity out/p_verity out/h_verity out/p_verity >/dev/null 2>&1; then
+    fail "✘ --touch=$bad accepted"; exit 1
+  fi
+done
+pass "✔ Malformed --touch rejected"
+
+note "[DONE] Verity lazy verification demonstrated."